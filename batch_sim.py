@@ -0,0 +1,174 @@
+import argparse
+import csv
+import os
+import subprocess
+import sys
+import tempfile
+import time
+from multiprocessing import Pool
+
+import numpy as np
+
+# Paralelna SystemC verifikacija nad vise iskaza.
+# Manifest: jedan direktorijum iskaza po redu (isti raspored kao koren projekta: matrice/ sa ulazima).
+# Manifest se deli na shard-ove, svaki radnik pokrece svoju systemc_sim instancu (svoj SystemC kernel)
+# nad svojim shard-om, pa se rezultati spajaju u jedan CSV i sumarnu statistiku.
+
+OUT_SC = "izlaz_multihead_systemc.txt"
+OUT_CPP = "izlaz_cpp.txt"
+
+
+#referenca se cuva pod imenom sa parametrima, da se gusta i window referenca nikad ne pomesaju
+def reference_file(window, num_global):
+    return f"izlaz_cpp_w{window}_g{num_global}.txt"
+
+
+def read_manifest(path):
+    with open(path, 'r') as f:
+        lines = [line.strip() for line in f]
+    return [line for line in lines if line and not line.startswith('#')]
+
+
+#greska SystemC izlaza u odnosu na C++ referencu za jedan iskaz
+def error_stats(utt_dir, ref_name, tolerance):
+    sc_file = os.path.join(utt_dir, OUT_SC)
+    cpp_file = os.path.join(utt_dir, ref_name)
+    if not os.path.exists(sc_file) or not os.path.exists(cpp_file):
+        return None
+    a = np.loadtxt(sc_file, ndmin=2)
+    b = np.loadtxt(cpp_file, ndmin=2)
+    if a.shape != b.shape:
+        return None
+    diff = np.abs(a - b)
+    return {"max_abs_err": float(diff.max()), "mean_abs_err": float(diff.mean()),
+            "pass": bool(diff.max() <= tolerance)}
+
+
+#jedan radnik: referenca (ako fali za ove parametre), pa SystemC nad celim shard-om u jednom procesu, pa greske
+def run_shard(job):
+    shard_id, dirs, opts = job
+    ref_name = reference_file(opts["window"], opts["num_global"])
+    ref_failed = {}
+    for d in dirs:
+        if not os.path.isdir(os.path.join(d, "matrice")):
+            continue
+        if opts["rerun_ref"] or not os.path.exists(os.path.join(d, ref_name)):
+            #referenca cita matrice/ i pise OUT_CPP relativno u odnosu na radni direktorijum
+            #stari OUT_CPP brisemo da ga posle neuspelog pokretanja ne bismo uzeli kao rezultat
+            if os.path.exists(os.path.join(d, OUT_CPP)):
+                os.remove(os.path.join(d, OUT_CPP))
+            proc = subprocess.run([opts["ref"], str(opts["window"]), str(opts["num_global"])], cwd=d,
+                                  stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+            if proc.returncode != 0 or not os.path.exists(os.path.join(d, OUT_CPP)):
+                tail = proc.stdout.strip().splitlines()[-1:] if proc.stdout else []
+                ref_failed[d] = f"ref_failed({proc.returncode})"
+                print(f"GRESKA: referenca za {d} nije uspela (kod {proc.returncode}) {' '.join(tail)}")
+                continue
+            os.replace(os.path.join(d, OUT_CPP), os.path.join(d, ref_name))
+
+    shard_manifest = os.path.join(opts["tmp_dir"], f"shard_{shard_id}.txt")
+    shard_report = os.path.join(opts["tmp_dir"], f"shard_{shard_id}.csv")
+    with open(shard_manifest, 'w') as f:
+        f.write("\n".join(dirs) + "\n")
+
+    log_file = os.path.join(opts["tmp_dir"], f"shard_{shard_id}.log")
+    with open(log_file, 'w') as log:
+        subprocess.run([opts["sim"], "--manifest", shard_manifest, "--report", shard_report,
+                        str(opts["window"]), str(opts["num_global"])], stdout=log, stderr=subprocess.STDOUT)
+
+    rows = {}
+    if os.path.exists(shard_report):
+        with open(shard_report, 'r') as f:
+            for row in csv.DictReader(f):
+                rows[row["utterance"]] = row
+
+    results = []
+    for d in dirs:
+        row = rows.get(d, {"utterance": d, "status": "crashed", "seq_len": 0, "cycles": 0, "macs": 0, "mac_cycles": 0})
+        if d in ref_failed:
+            row = dict(row, status=ref_failed[d])
+        stats = error_stats(d, ref_name, opts["tolerance"]) if row["status"] == "ok" else None
+        results.append({
+            "utterance": d,
+            "shard": shard_id,
+            "status": row["status"],
+            "seq_len": int(row["seq_len"]),
+            "cycles": int(row["cycles"]),
+            "macs": int(row["macs"]),
+            "mac_cycles": int(row["mac_cycles"]),
+            "max_abs_err": stats["max_abs_err"] if stats else float("nan"),
+            "mean_abs_err": stats["mean_abs_err"] if stats else float("nan"),
+            "pass": stats["pass"] if stats else False,
+        })
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Paralelna SystemC simulacija nad manifestom iskaza")
+    parser.add_argument("manifest", help="fajl sa direktorijumima iskaza, jedan po redu")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="broj radnika (podrazumevano: broj jezgara)")
+    parser.add_argument("--sim", default="./systemc_sim", help="SystemC izvrsni fajl")
+    parser.add_argument("--ref", default="./reference_sim", help="C++ referenca")
+    parser.add_argument("--rerun-ref", action="store_true", help="ponovo generise referencu i kada vec postoji za ove parametre")
+    parser.add_argument("--window", type=int, default=0, help="sliding window (0 - gusta attention)")
+    parser.add_argument("--global-tokens", type=int, default=0, help="broj globalnih tokena uz sliding window")
+    parser.add_argument("--tolerance", type=float, default=0.01, help="dozvoljena max abs greska")
+    parser.add_argument("--out", default="batch_rezultati.csv", help="spojeni CSV sa rezultatima po iskazu")
+    args = parser.parse_args()
+
+    dirs = read_manifest(args.manifest)
+    if not dirs:
+        print("Manifest je prazan.")
+        return 1
+
+    jobs = max(1, min(args.jobs, len(dirs)))
+    #round-robin, da dugacki i kratki iskazi budu ravnomerno rasporedjeni
+    shards = [dirs[i::jobs] for i in range(jobs)]
+
+    print(f"Iskaza: {len(dirs)} | Radnika: {jobs}")
+    start = time.time()
+    with tempfile.TemporaryDirectory(prefix="batch_sim_") as tmp_dir:
+        opts = {"sim": os.path.abspath(args.sim), "ref": os.path.abspath(args.ref), "rerun_ref": args.rerun_ref,
+                "window": args.window, "num_global": args.global_tokens, "tolerance": args.tolerance,
+                "tmp_dir": tmp_dir}
+        with Pool(jobs) as pool:
+            shard_results = pool.map(run_shard, [(i, shard, opts) for i, shard in enumerate(shards)])
+    elapsed = time.time() - start
+
+    #spajanje, redosled kao u manifestu
+    order = {d: i for i, d in enumerate(dirs)}
+    results = sorted((r for shard in shard_results for r in shard), key=lambda r: order[r["utterance"]])
+
+    fields = ["utterance", "shard", "status", "seq_len", "cycles", "macs", "mac_cycles", "max_abs_err", "mean_abs_err", "pass"]
+    with open(args.out, 'w', newline='') as f:
+        writer = csv.DictWriter(f, fieldnames=fields)
+        writer.writeheader()
+        writer.writerows(results)
+
+    ok = [r for r in results if r["status"] == "ok"]
+    compared = [r for r in ok if not np.isnan(r["max_abs_err"])]
+    passed = [r for r in compared if r["pass"]]
+
+    print("==================================================")
+    print(f"Obradjeno: {len(ok)}/{len(results)} | Uporedjeno sa referencom: {len(compared)} | Prolazi: {len(passed)}")
+    if ok:
+        cycles = np.array([r["cycles"] for r in ok])
+        macs = np.array([r["macs"] for r in ok])
+        print(f"Ciklusa ukupno: {cycles.sum():.0f} | po iskazu: srednje {cycles.mean():.1f}, max {cycles.max():.0f}")
+        print(f"MAC operacija ukupno: {macs.sum()} | po iskazu srednje: {macs.mean():.0f}")
+    if compared:
+        max_err = np.array([r["max_abs_err"] for r in compared])
+        mean_err = np.array([r["mean_abs_err"] for r in compared])
+        worst = compared[int(max_err.argmax())]["utterance"]
+        print(f"Max abs greska: {max_err.max():.6g} ({worst}) | Srednja abs greska: {mean_err.mean():.6g}")
+    for r in results:
+        if r["status"] != "ok":
+            print(f"GRESKA: {r['utterance']} -> {r['status']}")
+    print(f"Vreme: {elapsed:.1f} s | Rezultati: {args.out}")
+    print("==================================================")
+
+    return 0 if len(passed) == len(results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -28,9 +28,22 @@ def compare_files(file1, file2, tolerance=0.01):
     print("SUCCESS! The Files are numerically indentical within the given tolerance.")
     return True
 
+#Statistika greske izmedju dva fajla (npr. sliding window naspram guste reference)
+def error_stats(file1, file2):
+    a = np.loadtxt(file1, ndmin=2)
+    b = np.loadtxt(file2, ndmin=2)
+    if a.shape != b.shape:
+        print(f"Error! Files have different shapes! ({a.shape} vs {b.shape})")
+        return None
+    diff = np.abs(a - b)
+    rel = np.linalg.norm(a - b) / max(np.linalg.norm(b), 1e-12)
+    print(f"Max abs greska: {diff.max():.6g} | Srednja abs greska: {diff.mean():.6g} | Relativna (L2) greska: {rel:.6g}")
+    return diff.max(), diff.mean(), rel
+
 if __name__ == "__main__":
     if len(sys.argv) != 3:
         print("Upotreba: python3 compare.py <fajl1> <fajl2>")
         sys.exit(1)
 
-    compare_files(sys.argv[1], sys.argv[2])
\ No newline at end of file
+    compare_files(sys.argv[1], sys.argv[2])
+    error_stats(sys.argv[1], sys.argv[2])
\ No newline at end of file
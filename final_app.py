@@ -4,6 +4,7 @@ import numpy as np
 from transformers import WhisperProcessor, WhisperForConditionalGeneration
 from transformers.models.whisper.modeling_whisper import WhisperAttention
 import queue
+import threading
 import os
 import soundfile as sf
 
@@ -24,16 +25,56 @@ BLOCK_SIZE = 1024
 USE_CPP_ATTENTION = True     # True koristi C++ funkciju
 USE_MICROPHONE = False        # True - hvata sa mikrofona False - uzima .wav fajl umesto mikrofona
 TEST_WAV = "whisper.wav"         
+USE_LENGTH_MASK = False       # True - attention se racuna samo nad stvarnim frejmovima snimka (bez 30s paddinga)
+ATTENTION_WINDOW = 0          # >0 - sliding window attention (svaki frejm gleda +-ATTENTION_WINDOW suseda), 0 - gusta
+ATTENTION_GLOBAL_TOKENS = 0   # broj prvih frejmova koji gledaju i koje vide svi (samo uz ATTENTION_WINDOW > 0)
+MEASURE_WINDOW_ACCURACY = False  # True - poredi sliding window sa gustom attention na WAV fajlovima ispod
+ACCURACY_WAVS = ["whisper.wav", "normal.wav"]
 
 q = queue.Queue()
 
 def audio_callback(indata, frames, time, status):
     q.put(indata.copy())
 
+#Broj frejmova enkodera za snimak od num_samples uzoraka (hop 160, pa conv sa korakom 2)
+def audio_to_frame_length(num_samples, max_frames=1500):
+    mel_frames = int(np.ceil(num_samples / 160))
+    return min(max_frames, (mel_frames + 1) // 2)
+
+#HF attention_mask (B, 1, tgt, src) -> duzine po uzorku i da li je maska kauzalna
+#C++ strana podrzava samo self-attention (tgt == src) sa desnim paddingom (prefiks duzine L),
+#opciono u kombinaciji sa kauzalnom maskom; sve ostalo (levi padding, rupe u maski) je greska
+def mask_to_lengths(attention_mask, batch, seq_len):
+    if attention_mask is None:
+        return [seq_len] * batch, False
+    valid = attention_mask[:, 0] > torch.finfo(attention_mask.dtype).min / 2
+    tgt, src = valid.shape[-2:]
+    if tgt != seq_len or src != seq_len:
+        raise RuntimeError(f"attention_mask {tuple(valid.shape[-2:])} nije kvadratna za seq_len {seq_len}!")
+
+    lengths = valid.any(dim=1).sum(dim=-1)
+    positions = torch.arange(src, device=valid.device)
+    prefix = (positions[None, :] < lengths[:, None])[:, None, :].expand(batch, tgt, src)
+    tril = torch.tril(torch.ones(tgt, src, dtype=torch.bool, device=valid.device))
+
+    if seq_len > 1 and torch.equal(valid, prefix & tril):
+        causal = True
+    elif torch.equal(valid, prefix):
+        causal = False
+    else:
+        raise RuntimeError("attention_mask nije prefiks (desni padding) niti kauzalna prefiks maska!")
+    return [int(l) for l in lengths.tolist()], causal
+
 #Moj custom attention block
 class AttentionWhisperBlock(WhisperAttention):
     def __init__(self, embed_dim, num_heads, dropout, is_decoder=False):
         super().__init__(embed_dim, num_heads, dropout, is_decoder)
+        #duzine u frejmovima za svaki uzorak batcha, postavlja se pre generate (None - cela sekvenca)
+        self.frame_lengths = None
+        self.window = ATTENTION_WINDOW
+        self.num_global = ATTENTION_GLOBAL_TOKENS
+        #poslednji izlaz attention-a (pre out_proj), za merenje tacnosti
+        self.last_output = None
 
     def forward(self, hidden_states, key_value_states=None, past_key_value=None,
                 attention_mask=None, layer_head_mask=None, output_attentions=False):
@@ -54,6 +95,25 @@ class AttentionWhisperBlock(WhisperAttention):
         k_list = K.detach().cpu().numpy()
         v_list = V.detach().cpu().numpy()
         print("Skaliranje zavrseno...")
+
+        batch, seq_len = q_list.shape[0], q_list.shape[1]
+        lengths, causal = mask_to_lengths(attention_mask, batch, seq_len)
+        if attention_mask is None and self.frame_lengths is not None:
+            lengths = [min(seq_len, int(l)) for l in self.frame_lengths]
+
+        #saljemo samo validne redove, pa nema racunanja nad paddingom
+        #poziv je asinhron: C++ racuna u pozadinskoj niti dok mi cuvamo matrice
+        attn_future = multihead_attention_algorithm.attention_core_batched_async(
+            [q_list[b, :lengths[b]].tolist() for b in range(batch)],
+            [k_list[b, :lengths[b]].tolist() for b in range(batch)],
+            [v_list[b, :lengths[b]].tolist() for b in range(batch)],
+            int(self.num_heads),
+            lengths,
+            causal,
+            int(self.window),
+            int(self.num_global)
+        )
+
         if not os.path.exists("matrice"):
             os.makedirs("matrice")
 
@@ -70,18 +130,14 @@ class AttentionWhisperBlock(WhisperAttention):
         np.savetxt("matrice/multihead_W_out.txt", self.out_proj.weight.detach().cpu().numpy().T)
         np.savetxt("matrice/multihead_b_out.txt", self.out_proj.bias.detach().cpu().numpy())
 
-        outputs = []
-        for b in range(q_list.shape[0]):
-            attn_out_b = multihead_attention_algorithm.attention_core(
-                q_list[b].tolist(),
-                k_list[b].tolist(),
-                v_list[b].tolist(),
-                int(self.num_heads)
-            )
-            
-            outputs.append(np.array(attn_out_b, dtype=np.float32))
-
-        attn_output_np = np.stack(outputs, axis=0)
+        attn_outs = attn_future.result()
+
+        #vracamo padding (nule) da bi oblik odgovarao ostatku modela
+        attn_output_np = np.zeros(q_list.shape, dtype=np.float32)
+        for b in range(batch):
+            if lengths[b] > 0:
+                attn_output_np[b, :lengths[b]] = np.array(attn_outs[b], dtype=np.float32)
+        self.last_output = attn_output_np
         attn_output = torch.from_numpy(attn_output_np).to(hidden_states.device, dtype=hidden_states.dtype)
 
         #finalni linearni sloj
@@ -96,6 +152,12 @@ class AttentionWhisperBlock(WhisperAttention):
         else:
             return attn_output, None, None
 
+#postavlja stvarne duzine snimaka u nas attention sloj (ako je USE_LENGTH_MASK ukljucen)
+def set_frame_lengths(model, num_samples_list):
+    layer = model.model.encoder.layers[0].self_attn
+    if isinstance(layer, AttentionWhisperBlock):
+        layer.frame_lengths = [audio_to_frame_length(n) for n in num_samples_list] if USE_LENGTH_MASK else None
+
 #offline test(koristi .wav fajl)
 def offline_test(processor, model, device):
     print(f"Ucitavanje {TEST_WAV} fajla...")
@@ -105,11 +167,52 @@ def offline_test(processor, model, device):
         audio = resampy.resample(audio, sr, 16000)
         sr = 16000
     inputs = processor(audio, sampling_rate=sr, return_tensors="pt")
+    set_frame_lengths(model, [len(audio)])
     predicted_ids = model.generate(inputs.input_features.to(device))
     text = processor.batch_decode(predicted_ids, skip_special_tokens=True)
     print("Transkripcija:", text[0] if text else "<nista>")
     print("---------------------------")
 
+#meri uticaj sliding window-a: za svaki WAV poredi izlaz attention sloja i transkripciju sa gustom verzijom
+def window_accuracy_test(processor, model, device):
+    layer = model.model.encoder.layers[0].self_attn
+    if not isinstance(layer, AttentionWhisperBlock) or ATTENTION_WINDOW <= 0:
+        print("Merenje tacnosti zahteva USE_CPP_ATTENTION = True i ATTENTION_WINDOW > 0")
+        return
+
+    print(f"Sliding window {ATTENTION_WINDOW} (globalnih tokena: {ATTENTION_GLOBAL_TOKENS}) naspram guste attention")
+    for wav in ACCURACY_WAVS:
+        audio, sr = sf.read(wav)
+        if audio.ndim > 1:
+            audio = audio.mean(axis=1)
+        if sr != 16000:
+            import resampy
+            audio = resampy.resample(audio, sr, 16000)
+            sr = 16000
+        features = processor(audio, sampling_rate=sr, return_tensors="pt").input_features.to(device)
+        set_frame_lengths(model, [len(audio)])
+
+        results = {}
+        for window, num_global in [(0, 0), (ATTENTION_WINDOW, ATTENTION_GLOBAL_TOKENS)]:
+            layer.window, layer.num_global = window, num_global
+            with torch.no_grad():
+                predicted_ids = model.generate(features)
+            text = processor.batch_decode(predicted_ids, skip_special_tokens=True)
+            #enkoder (pa i nas sloj) se poziva jednom po generate
+            results[window] = (layer.last_output.copy(), text[0].strip() if text else "")
+
+        dense_out, dense_text = results[0]
+        window_out, window_text = results[ATTENTION_WINDOW]
+        diff = np.abs(window_out - dense_out)
+        rel = np.linalg.norm(window_out - dense_out) / max(np.linalg.norm(dense_out), 1e-12)
+        print(f"[{wav}] max abs greska: {diff.max():.6g} | srednja: {diff.mean():.6g} | relativna (L2): {rel:.6g}")
+        print(f"[{wav}] gusta:  {dense_text}")
+        print(f"[{wav}] window: {window_text}")
+        print(f"[{wav}] transkripcija {'ISTA' if dense_text == window_text else 'RAZLICITA'}")
+
+    layer.window, layer.num_global = ATTENTION_WINDOW, ATTENTION_GLOBAL_TOKENS
+    print("---------------------------")
+
 
 #glavni deo programa
 def main():
@@ -132,11 +235,55 @@ def main():
     else:
         print("Koristimo originalni HuggingFace attention.\n")
 
+    if MEASURE_WINDOW_ACCURACY:
+        window_accuracy_test(processor, model, device)
+        return
+
     if not USE_MICROPHONE:
         offline_test(processor, model, device)
         return
 
     #ako koristimo mikrofon
+    #pipeline: glavna nit snima, jedna nit racuna feature-e, druga radi generate (attention u C++ bez GIL-a)
+    #pa se snimanje sledeceg iskaza preklapa sa obradom prethodnih
+    audio_q = queue.Queue()
+    features_q = queue.Queue()
+
+    def feature_worker():
+        while True:
+            full_audio = audio_q.get()
+            if full_audio is None:
+                features_q.put(None)
+                return
+            try:
+                input_features = processor(full_audio, sampling_rate=SAMPLE_RATE, return_tensors="pt").input_features.to(device)
+                features_q.put((input_features, len(full_audio)))
+            except Exception as e:
+                print(f"Došlo je do greške (feature-i): {e}")
+
+    def transcription_worker():
+        while True:
+            item = features_q.get()
+            if item is None:
+                return
+            input_features, num_samples = item
+            try:
+                set_frame_lengths(model, [num_samples])
+                predicted_ids = model.generate(input_features)
+                forced_ids = processor.get_decoder_prompt_ids(language="en", task="transcribe")
+                transcription = processor.batch_decode(predicted_ids, skip_special_tokens=True)
+
+                print("\n****FINALNA TRANSKRIPCIJA****")
+                print(transcription[0].strip() if transcription and transcription[0].strip() else "Nema prepoznatog govora")
+                print("---------------------------\n")
+            except Exception as e:
+                print(f"Došlo je do greške (transkripcija): {e}")
+
+    workers = [threading.Thread(target=feature_worker, daemon=True),
+               threading.Thread(target=transcription_worker, daemon=True)]
+    for w in workers:
+        w.start()
+
     while True:
         try:
             num_blocks_to_record = int(RECORD_SECONDS * SAMPLE_RATE / BLOCK_SIZE)
@@ -150,18 +297,10 @@ def main():
                                 blocksize=BLOCK_SIZE, callback=audio_callback):
                 for _ in range(num_blocks_to_record):
                     audio_data.append(q.get())
-            print("Snimanje završeno, obrađujem snimak...")
+            print("Snimanje završeno, snimak je poslat na obradu (mozete odmah snimati sledeci)...")
 
             if audio_data:
-                full_audio = np.concatenate(audio_data, axis=0).flatten()
-                input_features = processor(full_audio, sampling_rate=SAMPLE_RATE, return_tensors="pt").input_features.to(device)
-                predicted_ids = model.generate(input_features)
-                forced_ids = processor.get_decoder_prompt_ids(language="en", task="transcribe")
-                transcription = processor.batch_decode(predicted_ids, skip_special_tokens=True)
-
-                print("\n****FINALNA TRANSKRIPCIJA****")
-                print(transcription[0].strip() if transcription and transcription[0].strip() else "Nema prepoznatog govora")
-                print("---------------------------\n")
+                audio_q.put(np.concatenate(audio_data, axis=0).flatten())
 
         except KeyboardInterrupt:
             print("\nProgram prekinut.")
@@ -170,5 +309,10 @@ def main():
             print(f"Došlo je do greške: {e}")
             break
 
+    #zavrsavamo obradu snimaka koji su vec u redu
+    audio_q.put(None)
+    for w in workers:
+        w.join()
+
 if __name__ == "__main__":
     main()
@@ -3,8 +3,69 @@
 
 #include <systemc.h>
 #include <iostream> 
+#include <algorithm>
 #include "datatypes.h"
 
+//Velicina bloka za blok-retko (sliding window) mnozenje
+const size_t SPARSE_TILE = 32;
+
+//Sirina MAC jedinice: toliko MAC operacija se izvrsi u jednom ciklusu
+//(jedan red head_dim = 64 po ciklusu), koristi se za model kasnjenja
+const size_t MAC_UNIT_WIDTH = 64;
+
+//Broj ciklusa za n operacija na jedinici sirine MAC_UNIT_WIDTH
+inline unsigned long long unit_cycles(unsigned long long n) {
+    return (n + MAC_UNIT_WIDTH - 1) / MAC_UNIT_WIDTH;
+}
+
+//Maska za sliding window: na izlazu (Q*K^T, j je kljuc) ili na k (Probs*V, k je kljuc)
+enum WindowMaskMode { MASK_NONE, MASK_OUTPUT, MASK_K };
+
+//Da li red i gleda kljuc j (window == 0 -> gusto), prvih num_global tokena je globalno
+inline bool window_allowed(size_t i, size_t j, size_t window, size_t num_global) {
+    if (window == 0 || i < num_global || j < num_global) return true;
+    return (i > j ? i - j : j - i) <= window;
+}
+
+//Kljucevi koje red i gleda (od ukupno n) kao najvise dva opsega [lo, hi):
+//globalni tokeni [0, num_global) i lokalni prozor [i - window, i + window]
+inline size_t window_ranges(size_t i, size_t n, size_t window, size_t num_global, size_t lo[2], size_t hi[2]) {
+    if (window == 0 || i < num_global) { lo[0] = 0; hi[0] = n; return 1; }
+    size_t local_lo = i > window ? i - window : 0;
+    size_t local_hi = std::min(n, i + window + 1);
+    size_t global_hi = std::min(num_global, n);
+    if (global_hi >= local_lo) { lo[0] = 0; hi[0] = local_hi; return 1; }
+    lo[0] = 0; hi[0] = global_hi;
+    lo[1] = local_lo; hi[1] = local_hi;
+    return 2;
+}
+
+//Da li blok [i0,i1) x [j0,j1) ima bar jedan element u prozoru
+inline bool window_tile_alive(size_t i0, size_t i1, size_t j0, size_t j1, size_t window, size_t num_global) {
+    if (window == 0 || i0 < num_global || j0 < num_global) return true;
+    return j0 <= i1 - 1 + window && j1 - 1 + window >= i0;
+}
+
+//MAC jedinica fiksne sirine K (kao hardverska jedinica za head_dim 32/64/128)
+//Granica petlje je konstanta, pa je datapath iste sirine za svaki red
+template<size_t K>
+inline ACC_T mac_fixed(const Vector& x, const Vector& w) {
+    ACC_T sum = 0.0;
+    for (size_t k = 0; k < K; ++k) {
+        sum += x[k] * w[k];
+    }
+    return sum;
+}
+
+//Genericka MAC petlja za ostale sirine (npr. Probs * V gde je k = seq_len)
+inline ACC_T mac_generic(const Vector& x, const Vector& w, size_t in_feat) {
+    ACC_T sum = 0.0;
+    for (size_t k = 0; k < in_feat; ++k) {
+        sum += x[k] * w[k];
+    }
+    return sum;
+}
+
 SC_MODULE(MatrixMultiplier) {
     sc_in<bool> clk;
     sc_in<bool> start;
@@ -15,8 +76,26 @@ SC_MODULE(MatrixMultiplier) {
     const Vector* b_ptr = nullptr;
     Matrix* Y_ptr = nullptr;
 
+    //Sliding window podesavanja (window == 0 -> gusto mnozenje)
+    WindowMaskMode mask_mode = MASK_NONE;
+    size_t window = 0;
+    size_t num_global = 0;
+
+    //Broj izvrsenih MAC operacija (za poredjenje gusto/retko)
+    unsigned long long mac_count = 0;
+    //Broj ciklusa koje je jedinica provela racunajuci (svaki izlaz: unit_cycles(broj MAC-ova))
+    unsigned long long busy_cycles = 0;
+
+    //Perioda takta, meri se na pocetku simulacije
+    sc_time clk_period;
+
     void multiply_process() {
         done.write(false);
+        wait(clk->posedge_event());
+        sc_time first_edge = sc_time_stamp();
+        wait(clk->posedge_event());
+        clk_period = sc_time_stamp() - first_edge;
+
         while (true) {
             //cekamo start signal
             do { wait(clk->posedge_event()); } while (start.read() == false);
@@ -29,26 +108,67 @@ SC_MODULE(MatrixMultiplier) {
             size_t in_feat = X[0].size();
             size_t out_feat = W.size();
             
-            //logika
-            for (size_t i = 0; i < seq_len; ++i) {
-                for (size_t j = 0; j < out_feat; ++j) {
-                    ACC_T sum = 0.0; //32-bitni akumulator
-                    
-                    //Najzahtevniji deo (MAC operacije)
-                    for (size_t k = 0; k < in_feat; ++k) {
-                        sum += X[i][k] * W[j][k];
-                    }
-                    
-                    //Upis rezultata (sa ili bez biasa)
-                    if (b_ptr) { 
-                        Y[i][j] = sum + b_ptr->at(j); 
-                    } else { 
-                        Y[i][j] = sum; 
+            bool sparse = window > 0 && mask_mode != MASK_NONE;
+            unsigned long long cycles = 0;
+
+            //logika (po blokovima, blokovi van prozora se preskacu)
+            for (size_t i0 = 0; i0 < seq_len; i0 += SPARSE_TILE) {
+                size_t i1 = std::min(i0 + SPARSE_TILE, seq_len);
+                for (size_t j0 = 0; j0 < out_feat; j0 += SPARSE_TILE) {
+                    size_t j1 = std::min(j0 + SPARSE_TILE, out_feat);
+                    //ceo blok van prozora se preskace; Y za MASK_OUTPUT mora biti unapred nulovan
+                    if (sparse && mask_mode == MASK_OUTPUT && !window_tile_alive(i0, i1, j0, j1, window, num_global)) continue;
+
+                    for (size_t i = i0; i < i1; ++i) {
+                        for (size_t j = j0; j < j1; ++j) {
+                            //maskirani izlaz se ne racuna, softmax ga ionako ignorise
+                            if (sparse && mask_mode == MASK_OUTPUT && !window_allowed(i, j, window, num_global)) {
+                                Y[i][j] = 0.0;
+                                continue;
+                            }
+
+                            ACC_T sum = 0.0; //32-bitni akumulator
+
+                            //Najzahtevniji deo (MAC operacije)
+                            if (sparse && mask_mode == MASK_K) {
+                                unsigned long long macs = 0;
+                                for (size_t k0 = 0; k0 < in_feat; k0 += SPARSE_TILE) {
+                                    size_t k1 = std::min(k0 + SPARSE_TILE, in_feat);
+                                    if (!window_tile_alive(i0, i1, k0, k1, window, num_global)) continue;
+                                    for (size_t k = k0; k < k1; ++k) {
+                                        if (!window_allowed(i, k, window, num_global)) continue;
+                                        sum += X[i][k] * W[j][k];
+                                        ++macs;
+                                    }
+                                }
+                                mac_count += macs;
+                                cycles += unit_cycles(macs);
+                            } else {
+                                switch (in_feat) {
+                                    case 32:  sum = mac_fixed<32>(X[i], W[j]); break;
+                                    case 64:  sum = mac_fixed<64>(X[i], W[j]); break;
+                                    case 128: sum = mac_fixed<128>(X[i], W[j]); break;
+                                    default:  sum = mac_generic(X[i], W[j], in_feat); break;
+                                }
+                                mac_count += in_feat;
+                                cycles += unit_cycles(in_feat);
+                            }
+
+                            //Upis rezultata (sa ili bez biasa)
+                            if (b_ptr) {
+                                Y[i][j] = sum + b_ptr->at(j);
+                            } else {
+                                Y[i][j] = sum;
+                            }
+                        }
                     }
                 }
             }
 
-            
+            //racunanje traje onoliko ciklusa koliko je MAC jedinici potrebno
+            busy_cycles += cycles;
+            if (cycles > 0) { wait(clk_period * static_cast<double>(cycles)); }
+
             //signaliziramo kraj
             done.write(true);
             
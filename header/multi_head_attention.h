@@ -20,6 +20,9 @@ SC_MODULE(MultiHeadAttentionModule) {
     Matrix* Y_out_ptr = nullptr;
 
     int num_heads;
+    //Sliding window za sve glave (0 -> gusta attention)
+    size_t window = 0;
+    size_t num_global = 0;
     sc_vector<SingleHeadAttentionModule> attention_heads;
     MatrixMultiplier final_proj_unit;
     
@@ -39,11 +42,12 @@ SC_MODULE(MultiHeadAttentionModule) {
             size_t embed_dim = Q_in_ptr->at(0).size();
             size_t head_dim = embed_dim / num_heads;
 
-            q_heads_data.resize(num_heads, Matrix(seq_len, Vector(head_dim)));
-            k_heads_data.resize(num_heads, Matrix(seq_len, Vector(head_dim)));
-            v_heads_data.resize(num_heads, Matrix(seq_len, Vector(head_dim)));
-            attn_output_heads_data.resize(num_heads, Matrix(seq_len, Vector(head_dim)));
-            merged_heads_output.resize(seq_len, Vector(embed_dim));
+            //assign, a ne resize, jer modul obradjuje vise iskaza razlicitih duzina zaredom
+            q_heads_data.assign(num_heads, Matrix(seq_len, Vector(head_dim)));
+            k_heads_data.assign(num_heads, Matrix(seq_len, Vector(head_dim)));
+            v_heads_data.assign(num_heads, Matrix(seq_len, Vector(head_dim)));
+            attn_output_heads_data.assign(num_heads, Matrix(seq_len, Vector(head_dim)));
+            merged_heads_output.assign(seq_len, Vector(embed_dim));
 
             //Priprema podataka
             for (int h = 0; h < num_heads; ++h) {
@@ -58,6 +62,8 @@ SC_MODULE(MultiHeadAttentionModule) {
                 attention_heads[h].K_ptr = &k_heads_data[h];
                 attention_heads[h].V_ptr = &v_heads_data[h];
                 attention_heads[h].Y_ptr = &attn_output_heads_data[h];
+                attention_heads[h].window = window;
+                attention_heads[h].num_global = num_global;
             }
 
             std::cout << "@" << sc_time_stamp() << "Obrada glava (trenutno radi sekvencijalno, probacu paralelno kada spustim na plocu)..." << std::endl;
@@ -85,6 +91,7 @@ SC_MODULE(MultiHeadAttentionModule) {
             final_proj_unit.W_ptr = W_out_ptr; 
             final_proj_unit.b_ptr = b_out_ptr;
             final_proj_unit.Y_ptr = Y_out_ptr;
+            final_proj_unit.mask_mode = MASK_NONE;
             
             final_proj_start.write(true);
             wait(final_proj_done.posedge_event());
@@ -8,21 +8,30 @@
 #include "matrix_multiplier.h"
 
 
-inline std::vector<std::vector<PROB_T>> softmax_safe(const Matrix& mat) {
+//window > 0 -> elementi van prozora dobijaju verovatnocu 0 i uopste se ne citaju
+inline std::vector<std::vector<PROB_T>> softmax_safe(const Matrix& mat, size_t window = 0, size_t num_global = 0) {
     std::vector<std::vector<PROB_T>> result(mat.size(), std::vector<PROB_T>(mat[0].size()));
+    size_t lo[2], hi[2];
     for (size_t i = 0; i < mat.size(); ++i) {
-        double max_val = mat[i][0].to_double();
-        for (size_t j = 1; j < mat[i].size(); ++j) { 
-            if (mat[i][j].to_double() > max_val) max_val = mat[i][j].to_double(); 
+        size_t n_ranges = window_ranges(i, mat[i].size(), window, num_global, lo, hi);
+        double max_val = -INFINITY;
+        for (size_t r = 0; r < n_ranges; ++r) {
+            for (size_t j = lo[r]; j < hi[r]; ++j) {
+                if (mat[i][j].to_double() > max_val) max_val = mat[i][j].to_double();
+            }
         }
         double sum_exp = 0.0;
-        std::vector<double> exp_vals(mat[i].size());
-        for (size_t j = 0; j < mat[i].size(); ++j) {
-            exp_vals[j] = std::exp(mat[i][j].to_double() - max_val);
-            sum_exp += exp_vals[j];
+        std::vector<double> exp_vals(mat[i].size(), 0.0);
+        for (size_t r = 0; r < n_ranges; ++r) {
+            for (size_t j = lo[r]; j < hi[r]; ++j) {
+                exp_vals[j] = std::exp(mat[i][j].to_double() - max_val);
+                sum_exp += exp_vals[j];
+            }
         }
-        for (size_t j = 0; j < mat[i].size(); ++j) { 
-            result[i][j] = exp_vals[j] / sum_exp; 
+        for (size_t r = 0; r < n_ranges; ++r) {
+            for (size_t j = lo[r]; j < hi[r]; ++j) {
+                result[i][j] = exp_vals[j] / sum_exp;
+            }
         }
     }
     return result;
@@ -37,6 +46,10 @@ SC_MODULE(SingleHeadAttentionModule) {
     const Matrix* K_ptr = nullptr;
     const Matrix* V_ptr = nullptr;
     Matrix* Y_ptr = nullptr;
+
+    //Sliding window (0 -> gusta attention)
+    size_t window = 0;
+    size_t num_global = 0;
     
     MatrixMultiplier mat_mul_unit;
     sc_signal<bool> mat_mul_start_sig, mat_mul_done_sig;
@@ -52,6 +65,7 @@ SC_MODULE(SingleHeadAttentionModule) {
             //1. Q * K^T
             scores.assign(Q_ptr->size(), Vector(K_ptr->size()));
             mat_mul_unit.X_ptr = Q_ptr; mat_mul_unit.W_ptr = K_ptr; mat_mul_unit.b_ptr = nullptr; mat_mul_unit.Y_ptr = &scores;
+            mat_mul_unit.mask_mode = MASK_OUTPUT; mat_mul_unit.window = window; mat_mul_unit.num_global = num_global;
             
             mat_mul_start_sig.write(true);
             wait(mat_mul_done_sig.posedge_event());
@@ -61,7 +75,18 @@ SC_MODULE(SingleHeadAttentionModule) {
             //ovde sam inace radio skaliranje, ali sada to radi softver
             
             //2. Softmax
-            std::vector<std::vector<PROB_T>> probs_precise = softmax_safe(scores);
+            std::vector<std::vector<PROB_T>> probs_precise = softmax_safe(scores, window, num_global);
+
+            //softmax jedinica iste sirine: po redu unit_cycles(broj nemaskiranih elemenata)
+            unsigned long long softmax_cycles = 0;
+            size_t lo[2], hi[2];
+            for (size_t i = 0; i < scores.size(); ++i) {
+                size_t n_ranges = window_ranges(i, scores[i].size(), window, num_global, lo, hi);
+                unsigned long long row_len = 0;
+                for (size_t r = 0; r < n_ranges; ++r) { row_len += hi[r] - lo[r]; }
+                softmax_cycles += unit_cycles(row_len);
+            }
+            wait(mat_mul_unit.clk_period * static_cast<double>(softmax_cycles));
             probs.assign(probs_precise.size(), Vector(probs_precise[0].size()));
             
             for(size_t i=0; i<probs_precise.size(); ++i) {
@@ -81,6 +106,7 @@ SC_MODULE(SingleHeadAttentionModule) {
             }
             
             mat_mul_unit.X_ptr = &probs; mat_mul_unit.W_ptr = &V_T; mat_mul_unit.b_ptr = nullptr; mat_mul_unit.Y_ptr = Y_ptr;
+            mat_mul_unit.mask_mode = MASK_K;
             
             mat_mul_start_sig.write(true);
             wait(mat_mul_done_sig.posedge_event());
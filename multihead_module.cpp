@@ -92,6 +92,17 @@ Matrix matmul_standard(const Matrix& A, const Matrix& B) {
     return C;
 }
 
+//Sliding window maska: van prozora -inf, pa softmax daje 0 (window == 0 -> bez maske)
+void apply_window_mask(Matrix& scores, size_t window, size_t num_global) {
+    if (window == 0) return;
+    for (size_t i = 0; i < scores.size(); ++i) {
+        for (size_t j = 0; j < scores[i].size(); ++j) {
+            if (i < num_global || j < num_global) continue;
+            if ((i > j ? i - j : j - i) > window) scores[i][j] = -INFINITY;
+        }
+    }
+}
+
 Matrix softmax_internal(const Matrix& mat) {
     Matrix result = mat;
     for (size_t i = 0; i < mat.size(); ++i) {
@@ -107,7 +118,8 @@ Matrix softmax_internal(const Matrix& mat) {
     return result;
 }
 
-Matrix multi_head_attention_realtime(const Matrix& Q, const Matrix& K, const Matrix& V, int num_heads) {
+Matrix multi_head_attention_realtime(const Matrix& Q, const Matrix& K, const Matrix& V, int num_heads,
+                                     size_t window = 0, size_t num_global = 0) {
     size_t seq_len = Q.size(); size_t embed_dim = Q[0].size(); size_t head_dim = embed_dim / num_heads;
 	std::cout << " - POCETAK BITSKE ANALIZE - " << std::endl;
 	analyze_bits("Ulaz Q ", Q);
@@ -135,6 +147,7 @@ Matrix multi_head_attention_realtime(const Matrix& Q, const Matrix& K, const Mat
         //1. Mnozenje
         Matrix scores = matmul_transpose(q_heads[h], k_heads[h]);
         analyze_bits("Head " + std::to_string(h) + " Scores", scores);
+        apply_window_mask(scores, window, num_global);
         //2. Softmax (bez skaliranja)
         Matrix probs = softmax_internal(scores);
         analyze_bits("Head " + std::to_string(h) + " Scores(Softmax)", probs);
@@ -161,7 +174,10 @@ Matrix multi_head_attention_realtime(const Matrix& Q, const Matrix& K, const Mat
     return merged_output;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    //Upotreba: ./reference_sim [window] [num_global]
+    size_t window = argc > 1 ? std::stoul(argv[1]) : 0;
+    size_t num_global = argc > 2 ? std::stoul(argv[2]) : 0;
     std::cout << "Pokrecemo C++ referencu..." << std::endl;
     Matrix Q = readMatrix("matrice/multihead_ulaz_Q.txt");
     Matrix K = readMatrix("matrice/multihead_ulaz_K.txt");
@@ -171,7 +187,7 @@ int main() {
 	   
     if (Q.empty()) return 1;
 
-    Matrix merged = multi_head_attention_realtime(Q, K, V, 8);
+    Matrix merged = multi_head_attention_realtime(Q, K, V, 8, window, num_global);
     
     //Finalna projekcija
     Matrix final = matmul_standard(merged, W);
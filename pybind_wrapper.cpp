@@ -2,6 +2,14 @@
 #include <vector>
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <queue>
+#include <functional>
+#include <memory>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
@@ -15,6 +23,11 @@ namespace py = pybind11;
 Matrix matmul_standard(const Matrix& A, const Matrix& B);
 Matrix matmul_transpose(const Matrix& A, const Matrix& B, const Vector& bias = {});
 Matrix softmax_internal(const Matrix& mat);
+Matrix masked_head_attention(const Matrix& q, const Matrix& k, const Matrix& v, size_t len, bool causal,
+                             size_t window = 0, size_t num_global = 0);
+template<size_t D>
+Matrix masked_head_attention_kernel(const Matrix& q, const Matrix& k, const Matrix& v, size_t len, bool causal,
+                                    size_t window, size_t num_global);
 
 //Glavna funkcija
 Matrix multi_head_attention_core(const Matrix& Q, const Matrix& K, const Matrix& V, int num_heads) {
@@ -57,12 +70,212 @@ Matrix multi_head_attention_core(const Matrix& Q, const Matrix& K, const Matrix&
     return merged_output;
 }
 
+//Batch verzija: svaki uzorak ima svoju duzinu, nema paddinga
+//lengths prazan -> koristi se Q_batch[b].size(), inace samo prvih lengths[b] redova
+//window > 0 -> lokalna (sliding window) attention, prvih num_global tokena gleda i vidi sve
+std::vector<Matrix> multi_head_attention_batched(const std::vector<Matrix>& Q_batch, const std::vector<Matrix>& K_batch,
+                                                 const std::vector<Matrix>& V_batch, int num_heads,
+                                                 const std::vector<int>& lengths, bool causal,
+                                                 int window, int num_global) {
+    size_t batch = Q_batch.size();
+    if (K_batch.size() != batch || V_batch.size() != batch) {
+        throw std::runtime_error("Q, K i V nemaju isti broj uzoraka!");
+    }
+    if (!lengths.empty() && lengths.size() != batch) {
+        throw std::runtime_error("Broj duzina se ne poklapa sa brojem uzoraka!");
+    }
+    if (window < 0 || num_global < 0) {
+        throw std::runtime_error("window i num_global ne smeju biti negativni!");
+    }
+    if (num_heads <= 0) {
+        throw std::runtime_error("num_heads mora biti pozitivan!");
+    }
+
+    std::vector<Matrix> outputs(batch);
+    for (size_t b = 0; b < batch; ++b) {
+        const Matrix& Q = Q_batch[b];
+        const Matrix& K = K_batch[b];
+        const Matrix& V = V_batch[b];
+
+        size_t len = lengths.empty() ? Q.size() : static_cast<size_t>(lengths[b]);
+        if (len > Q.size() || len > K.size() || len > V.size()) {
+            throw std::runtime_error("Duzina uzorka je veca od broja redova!");
+        }
+        if (len == 0) { continue; }
+
+        size_t embed_dim = Q[0].size();
+        if (embed_dim == 0 || embed_dim % num_heads != 0) {
+            throw std::runtime_error("embed_dim nije deljiv sa num_heads!");
+        }
+        for (size_t i = 0; i < len; ++i) {
+            if (Q[i].size() != embed_dim || K[i].size() != embed_dim || V[i].size() != embed_dim) {
+                throw std::runtime_error("Redovi Q, K i V nemaju istu sirinu!");
+            }
+        }
+        size_t head_dim = embed_dim / num_heads;
+
+        //Splitujemo glave, samo validni redovi
+        Matrix3D q_heads(num_heads, Matrix(len, Vector(head_dim)));
+        Matrix3D k_heads(num_heads, Matrix(len, Vector(head_dim)));
+        Matrix3D v_heads(num_heads, Matrix(len, Vector(head_dim)));
+        for (int h = 0; h < num_heads; ++h) {
+            for (size_t i = 0; i < len; ++i) {
+                for (size_t j = 0; j < head_dim; ++j) {
+                    q_heads[h][i][j] = Q[i][h * head_dim + j];
+                    k_heads[h][i][j] = K[i][h * head_dim + j];
+                    v_heads[h][i][j] = V[i][h * head_dim + j];
+                }
+            }
+        }
+
+        Matrix merged_output(len, Vector(embed_dim));
+        for (int h = 0; h < num_heads; ++h) {
+            Matrix head_out = masked_head_attention(q_heads[h], k_heads[h], v_heads[h], len, causal,
+                                                    static_cast<size_t>(window), static_cast<size_t>(num_global));
+            for (size_t i = 0; i < len; ++i) {
+                for (size_t j = 0; j < head_dim; ++j) {
+                    merged_output[i][h * head_dim + j] = head_out[i][j];
+                }
+            }
+        }
+        outputs[b] = std::move(merged_output);
+    }
+    return outputs;
+}
+
+//Pozadinski izvrsilac: fiksan broj niti koje uzimaju poslove iz reda
+//Poslovi rade samo nad C++ kopijama podataka, pa ne drze Python GIL
+class AttentionExecutor {
+public:
+    explicit AttentionExecutor(size_t num_threads) {
+        for (size_t t = 0; t < num_threads; ++t) {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~AttentionExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& w : workers) { w.join(); }
+    }
+
+    template<typename F>
+    std::shared_future<std::vector<Matrix>> submit(F&& task) {
+        auto job = std::make_shared<std::packaged_task<std::vector<Matrix>()>>(std::forward<F>(task));
+        std::shared_future<std::vector<Matrix>> fut = job->get_future().share();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            jobs.push([job] { (*job)(); });
+        }
+        cv.notify_one();
+        return fut;
+    }
+
+    static AttentionExecutor& instance() {
+        static AttentionExecutor executor(std::max(1u, std::thread::hardware_concurrency()));
+        return executor;
+    }
+
+private:
+    void worker_loop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+};
+
+//Handle za asinhroni poziv, Python ga cuva i kasnije trazi rezultat
+//single == true -> rezultat je jedna matrica (attention_core), inace lista (attention_core_batched)
+struct AttentionFuture {
+    std::shared_future<std::vector<Matrix>> fut;
+    bool single = false;
+
+    bool done() const {
+        return fut.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void wait() const {
+        py::gil_scoped_release release;
+        fut.wait();
+    }
+
+    py::object result() const {
+        wait();
+        const std::vector<Matrix>& out = fut.get();
+        if (single) { return py::cast(out[0]); }
+        return py::cast(out);
+    }
+};
+
+AttentionFuture multi_head_attention_core_async(Matrix Q, Matrix K, Matrix V, int num_heads) {
+    AttentionFuture f;
+    f.single = true;
+    f.fut = AttentionExecutor::instance().submit(
+        [Q = std::move(Q), K = std::move(K), V = std::move(V), num_heads] {
+            return std::vector<Matrix>{ multi_head_attention_core(Q, K, V, num_heads) };
+        });
+    return f;
+}
+
+AttentionFuture multi_head_attention_batched_async(std::vector<Matrix> Q_batch, std::vector<Matrix> K_batch,
+                                                   std::vector<Matrix> V_batch, int num_heads,
+                                                   std::vector<int> lengths, bool causal,
+                                                   int window, int num_global) {
+    AttentionFuture f;
+    f.fut = AttentionExecutor::instance().submit(
+        [Q = std::move(Q_batch), K = std::move(K_batch), V = std::move(V_batch), num_heads,
+         lengths = std::move(lengths), causal, window, num_global] {
+            return multi_head_attention_batched(Q, K, V, num_heads, lengths, causal, window, num_global);
+        });
+    return f;
+}
+
 
 PYBIND11_MODULE(multihead_attention_algorithm, m) {
     m.doc() = "C++ modul za Multi-Head Attention";
     m.def("attention_core", &multi_head_attention_core, "MHA bez final proj",
+        py::arg("Q"), py::arg("K"), py::arg("V"), py::arg("num_heads"),
+        py::call_guard<py::gil_scoped_release>()
+    );
+    m.def("attention_core_batched", &multi_head_attention_batched,
+        "MHA za batch razlicitih duzina (bez paddinga), opciono kauzalna maska i sliding window. Vraca listu matrica duzine lengths[b]",
+        py::arg("Q"), py::arg("K"), py::arg("V"), py::arg("num_heads"),
+        py::arg("lengths") = std::vector<int>(), py::arg("causal") = false,
+        py::arg("window") = 0, py::arg("num_global") = 0,
+        py::call_guard<py::gil_scoped_release>()
+    );
+
+    py::class_<AttentionFuture>(m, "AttentionFuture")
+        .def("done", &AttentionFuture::done, "Da li je racunanje zavrseno (ne blokira)")
+        .def("wait", &AttentionFuture::wait, "Ceka kraj racunanja (bez GIL-a)")
+        .def("result", &AttentionFuture::result, "Ceka i vraca rezultat, baca gresku ako je racunanje palo");
+    m.def("attention_core_async", &multi_head_attention_core_async,
+        "Kao attention_core, ali odmah vraca AttentionFuture, racuna se u pozadinskoj niti",
         py::arg("Q"), py::arg("K"), py::arg("V"), py::arg("num_heads")
     );
+    m.def("attention_core_batched_async", &multi_head_attention_batched_async,
+        "Kao attention_core_batched, ali odmah vraca AttentionFuture, racuna se u pozadinskoj niti",
+        py::arg("Q"), py::arg("K"), py::arg("V"), py::arg("num_heads"),
+        py::arg("lengths") = std::vector<int>(), py::arg("causal") = false,
+        py::arg("window") = 0, py::arg("num_global") = 0
+    );
 }
 
 //Implementacije pomoćnih funkcija
@@ -84,20 +297,22 @@ Matrix matmul_standard(const Matrix& A, const Matrix& B) {
     return C;
 }
 
-Matrix matmul_transpose(const Matrix& A, const Matrix& B, const Vector& bias) {
+//Q * K^T sa fiksnom sirinom reda D (D == 0 -> sirina se cita u runtime-u)
+//Za fiksno D k petlja ima poznatu granicu i kompajler je potpuno odmotava
+template<size_t D>
+Matrix matmul_transpose_kernel(const Matrix& A, const Matrix& B, const Vector& bias) {
     size_t A_rows = A.size();
-    size_t A_cols = A[0].size();
+    const size_t A_cols = D ? D : A[0].size();
     size_t B_rows = B.size();
-	
-    if (A_cols != B[0].size()) {
-		throw std::runtime_error("Dimenzije za A * B^T se ne poklapaju!"); 
-	}
+
     Matrix C(A_rows, Vector(B_rows, 0.0f));
     for (size_t i = 0; i < A_rows; ++i) {
+        const float* a_row = A[i].data();
         for (size_t j = 0; j < B_rows; ++j) {
+            const float* b_row = B[j].data();
             float sum = 0.0f;
             for (size_t k = 0; k < A_cols; ++k) {
-                sum += A[i][k] * B[j][k];
+                sum += a_row[k] * b_row[k];
             }
             if (!bias.empty()) { C[i][j] = sum + bias[j]; }
             else { C[i][j] = sum; }
@@ -106,6 +321,17 @@ Matrix matmul_transpose(const Matrix& A, const Matrix& B, const Vector& bias) {
     return C;
 }
 
+Matrix matmul_transpose(const Matrix& A, const Matrix& B, const Vector& bias) {
+    if (A[0].size() != B[0].size()) {
+		throw std::runtime_error("Dimenzije za A * B^T se ne poklapaju!"); 
+	}
+    switch (A[0].size()) {
+        case 32:  return matmul_transpose_kernel<32>(A, B, bias);
+        case 64:  return matmul_transpose_kernel<64>(A, B, bias);
+        default:  return matmul_transpose_kernel<0>(A, B, bias);
+    }
+}
+
 Matrix softmax_internal(const Matrix& mat) {
     Matrix result = mat;
     for (size_t i = 0; i < mat.size(); ++i) {
@@ -123,4 +349,134 @@ Matrix softmax_internal(const Matrix& mat) {
 		}
     }
     return result;
-}
\ No newline at end of file
+}
+
+//Dozvoljeni kljucevi za red i su najvise dva neprekidna opsega [lo, hi):
+//globalni tokeni [0, num_global) i lokalni prozor [i - window, i + window], oba odsecena kauzalnom maskom i duzinom
+inline size_t allowed_ranges(size_t i, size_t len, bool causal, size_t window, size_t num_global,
+                             size_t lo[2], size_t hi[2]) {
+    size_t end = causal ? std::min(len, i + 1) : len;
+    if (window == 0 || i < num_global) { lo[0] = 0; hi[0] = end; return 1; }
+
+    size_t local_lo = i > window ? i - window : 0;
+    size_t local_hi = std::min(end, i + window + 1);
+    size_t global_hi = std::min(num_global, end);
+    if (global_hi >= local_lo) { lo[0] = 0; hi[0] = local_hi; return 1; }
+    lo[0] = 0; hi[0] = global_hi;
+    lo[1] = local_lo; hi[1] = local_hi;
+    return 2;
+}
+
+//Q * K^T za kljuceve [a, b): po 4 kljuca odjednom, svaki sa svojim akumulatorom (isti redosled sabiranja po d)
+template<size_t D>
+inline void score_range(const float* q_row, const Matrix& k, size_t a, size_t b, size_t head_dim,
+                        float* scores, float& max_val) {
+    const size_t dim = D ? D : head_dim;
+    size_t j = a;
+    for (; j + 4 <= b; j += 4) {
+        const float* k0 = k[j].data();
+        const float* k1 = k[j + 1].data();
+        const float* k2 = k[j + 2].data();
+        const float* k3 = k[j + 3].data();
+        float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+        for (size_t d = 0; d < dim; ++d) {
+            float q_d = q_row[d];
+            s0 += q_d * k0[d];
+            s1 += q_d * k1[d];
+            s2 += q_d * k2[d];
+            s3 += q_d * k3[d];
+        }
+        scores[j] = s0; scores[j + 1] = s1; scores[j + 2] = s2; scores[j + 3] = s3;
+        max_val = std::max(max_val, std::max(std::max(s0, s1), std::max(s2, s3)));
+    }
+    for (; j < b; ++j) {
+        const float* k_row = k[j].data();
+        float s = 0.0f;
+        for (size_t d = 0; d < dim; ++d) {
+            s += q_row[d] * k_row[d];
+        }
+        scores[j] = s;
+        max_val = std::max(max_val, s);
+    }
+}
+
+//out_row += p_j * V[j] za kljuceve [a, b), po 4 reda V odjednom (isti redosled sabiranja)
+template<size_t D>
+inline void accumulate_range(float* out_row, const Matrix& v, size_t a, size_t b, size_t head_dim,
+                             const float* probs) {
+    const size_t dim = D ? D : head_dim;
+    size_t j = a;
+    for (; j + 4 <= b; j += 4) {
+        const float* v0 = v[j].data();
+        const float* v1 = v[j + 1].data();
+        const float* v2 = v[j + 2].data();
+        const float* v3 = v[j + 3].data();
+        float p0 = probs[j], p1 = probs[j + 1], p2 = probs[j + 2], p3 = probs[j + 3];
+        for (size_t d = 0; d < dim; ++d) {
+            out_row[d] = (((out_row[d] + p0 * v0[d]) + p1 * v1[d]) + p2 * v2[d]) + p3 * v3[d];
+        }
+    }
+    for (; j < b; ++j) {
+        const float* v_row = v[j].data();
+        float p = probs[j];
+        for (size_t d = 0; d < dim; ++d) {
+            out_row[d] += p * v_row[d];
+        }
+    }
+}
+
+//Attention za jednu glavu: za svaki red se racunaju samo dozvoljeni opsezi kljuceva,
+//kljucevi iznad dijagonale (kauzalno), van prozora i van duzine se uopste ne citaju.
+//Sa prozorom cena je O(len * (window + num_global)) umesto O(len^2)
+//D je head_dim poznat u vreme kompajliranja (D == 0 -> genericka verzija, sirina iz runtime-a)
+template<size_t D>
+Matrix masked_head_attention_kernel(const Matrix& q, const Matrix& k, const Matrix& v, size_t len, bool causal,
+                                    size_t window, size_t num_global) {
+    const size_t head_dim = D ? D : q[0].size();
+    Matrix out(len, Vector(head_dim, 0.0f));
+    Vector row_scores(len);
+    float* scores = row_scores.data();
+    size_t lo[2], hi[2];
+
+    for (size_t i = 0; i < len; ++i) {
+        size_t n_ranges = allowed_ranges(i, len, causal, window, num_global, lo, hi);
+        const float* q_row = q[i].data();
+        float* out_row = out[i].data();
+
+        //1. Q * K^T
+        float max_val = -INFINITY;
+        for (size_t r = 0; r < n_ranges; ++r) {
+            score_range<D>(q_row, k, lo[r], hi[r], head_dim, scores, max_val);
+        }
+
+        //2. Softmax
+        float sum_exp = 0.0f;
+        for (size_t r = 0; r < n_ranges; ++r) {
+            for (size_t j = lo[r]; j < hi[r]; ++j) {
+                scores[j] = expf(scores[j] - max_val);
+                sum_exp += scores[j];
+            }
+        }
+        for (size_t r = 0; r < n_ranges; ++r) {
+            for (size_t j = lo[r]; j < hi[r]; ++j) {
+                scores[j] /= sum_exp;
+            }
+        }
+
+        //3. Probs * V
+        for (size_t r = 0; r < n_ranges; ++r) {
+            accumulate_range<D>(out_row, v, lo[r], hi[r], head_dim, scores);
+        }
+    }
+    return out;
+}
+
+//Specijalizacija se koristi samo gde je merljivo brza (head_dim 32); za 64 i 128
+//genericka verzija se vektorizuje jednako dobro, pa ide na nju
+Matrix masked_head_attention(const Matrix& q, const Matrix& k, const Matrix& v, size_t len, bool causal,
+                             size_t window, size_t num_global) {
+    switch (q[0].size()) {
+        case 32:  return masked_head_attention_kernel<32>(q, k, v, len, causal, window, num_global);
+        default:  return masked_head_attention_kernel<0>(q, k, v, len, causal, window, num_global);
+    }
+}
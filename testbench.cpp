@@ -14,6 +14,29 @@ Matrix readMatrix(const std::string& filename);
 Vector readVector(const std::string& filename);
 void writeMatrix(const std::string& filename, const Matrix& mat);
 
+//Sliding window podesavanja iz komandne linije (0 -> gusta attention)
+size_t g_window = 0;
+size_t g_num_global = 0;
+
+//Batch rezim: svaki red manifesta je direktorijum iskaza (sa matrice/ poddirektorijumom)
+//Bez --manifest obradjuje se samo tekuci direktorijum, kao ranije
+std::vector<std::string> g_utterances = { "." };
+std::string g_report_file;
+
+std::vector<std::string> readManifest(const std::string& filename) {
+    std::vector<std::string> dirs; std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        //isto kao read_manifest u batch_sim.py: odsecamo razmake, tabove i \r (CRLF manifest)
+        size_t first = line.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos) continue;
+        line = line.substr(first, line.find_last_not_of(" \t\r\n") - first + 1);
+        if (line[0] == '#') continue;
+        dirs.push_back(line);
+    }
+    return dirs;
+}
+
 Matrix transpose(const Matrix& mat) {
     if (mat.empty()) return mat;
     size_t rows = mat.size();
@@ -36,35 +59,74 @@ SC_MODULE(Testbench) {
     Vector b_out_data;
 
     void stimulus_process() {
-        std::cout << "Ucitavanje fajlova..." << std::endl;
-        Q_data = readMatrix("matrice/multihead_ulaz_Q.txt");
-        K_data = readMatrix("matrice/multihead_ulaz_K.txt");
-        V_data = readMatrix("matrice/multihead_ulaz_V.txt");
-        W_out_data_raw = readMatrix("matrice/multihead_W_out.txt");
-        b_out_data = readVector("matrice/multihead_b_out.txt");
-        
-        if (Q_data.empty()) return;
-
-        //Ovde transponujemo W zbog izlaza
-        W_out_data_transposed = transpose(W_out_data_raw);
-
-        Y_data.resize(Q_data.size(), Vector(Q_data[0].size()));
-
-        uut.Q_in_ptr = &Q_data;
-        uut.K_in_ptr = &K_data;
-        uut.V_in_ptr = &V_data;
-        uut.W_out_ptr = &W_out_data_transposed; 
-        uut.b_out_ptr = &b_out_data;
-        uut.Y_out_ptr = &Y_data;
+        std::ofstream report;
+        if (!g_report_file.empty()) {
+            report.open(g_report_file);
+            report << "utterance,status,seq_len,cycles,macs,mac_cycles" << std::endl;
+        }
 
         wait(10, SC_NS);
-        start_sig.write(true);
-        wait(clk.posedge_event());
-        start_sig.write(false);
+        for (const std::string& dir : g_utterances) {
+            std::cout << "Ucitavanje fajlova (" << dir << ")..." << std::endl;
+            Q_data = readMatrix(dir + "/matrice/multihead_ulaz_Q.txt");
+            K_data = readMatrix(dir + "/matrice/multihead_ulaz_K.txt");
+            V_data = readMatrix(dir + "/matrice/multihead_ulaz_V.txt");
+            W_out_data_raw = readMatrix(dir + "/matrice/multihead_W_out.txt");
+            b_out_data = readVector(dir + "/matrice/multihead_b_out.txt");
+
+            if (Q_data.empty()) {
+                std::cout << "GRESKA: nema ulaznih matrica u " << dir << std::endl;
+                if (report.is_open()) report << dir << ",missing,0,0,0,0" << std::endl;
+                continue;
+            }
+
+            //Ovde transponujemo W zbog izlaza
+            W_out_data_transposed = transpose(W_out_data_raw);
+
+            Y_data.assign(Q_data.size(), Vector(Q_data[0].size()));
+
+            uut.Q_in_ptr = &Q_data;
+            uut.K_in_ptr = &K_data;
+            uut.V_in_ptr = &V_data;
+            uut.W_out_ptr = &W_out_data_transposed; 
+            uut.b_out_ptr = &b_out_data;
+            uut.Y_out_ptr = &Y_data;
+            uut.window = g_window;
+            uut.num_global = g_num_global;
+            for (int h = 0; h < uut.num_heads; ++h) {
+                uut.attention_heads[h].mat_mul_unit.mac_count = 0;
+                uut.attention_heads[h].mat_mul_unit.busy_cycles = 0;
+            }
+
+            sc_time t_start = sc_time_stamp();
+            start_sig.write(true);
+            wait(clk.posedge_event());
+            start_sig.write(false);
+
+            wait(done_sig.posedge_event());
+            //glave i finalna projekcija trose cikluse srazmerno broju MAC operacija (vidi MAC_UNIT_WIDTH)
+            unsigned long long cycles = static_cast<unsigned long long>((sc_time_stamp() - t_start) / clk.period() + 0.5);
+
+            writeMatrix(dir + "/izlaz_multihead_systemc.txt", Y_data);
+
+            //mac_cycles: ciklusi u kojima MAC jedinice glava racunaju (bez softmax-a, finalne projekcije i handshake-a)
+            unsigned long long macs = 0, mac_cycles = 0;
+            for (int h = 0; h < uut.num_heads; ++h) {
+                macs += uut.attention_heads[h].mat_mul_unit.mac_count;
+                mac_cycles += uut.attention_heads[h].mat_mul_unit.busy_cycles;
+            }
+            std::cout << "Window: " << g_window << " (globalnih tokena: " << g_num_global << ")"
+                      << " | MAC operacija u glavama: " << macs << " | Ciklusa MAC jedinica: " << mac_cycles
+                      << " | Ciklusa: " << cycles << std::endl;
+            if (report.is_open()) {
+                report << dir << ",ok," << Q_data.size() << "," << cycles << "," << macs << "," << mac_cycles << std::endl;
+            }
+
+            //izlaz se spusta na sledecoj ivici, cekamo ga pre sledeceg iskaza
+            wait(clk.posedge_event());
+            wait(clk.posedge_event());
+        }
 
-        wait(done_sig.posedge_event());
-        
-        writeMatrix("izlaz_multihead_systemc.txt", Y_data);
         std::cout << "Simulacija zavrsena." << std::endl;
         sc_stop();
     }
@@ -76,6 +138,16 @@ SC_MODULE(Testbench) {
 };
 
 int sc_main(int argc, char* argv[]) {
+    //Upotreba: ./systemc_sim [--manifest fajl] [--report fajl.csv] [window] [num_global]
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--manifest" && i + 1 < argc) { g_utterances = readManifest(argv[++i]); }
+        else if (arg == "--report" && i + 1 < argc) { g_report_file = argv[++i]; }
+        else { positional.push_back(arg); }
+    }
+    if (positional.size() > 0) g_window = std::stoul(positional[0]);
+    if (positional.size() > 1) g_num_global = std::stoul(positional[1]);
     Testbench tb("Testbench_1");
     sc_start();
     return 0;